@@ -35,24 +35,25 @@ int main(void)
     TCCR1B = (1 << WGM13) | (1 << WGM12) | (1 << CS11);
     
     // Set initial duty cycle (50%)
-    OCR1A = (ICR1 * duty_cycle) / 100;  // 50% duty cycle
+    // Multiply in 32 bits: ICR1 * 50 = 99950 overflows a 16-bit unsigned int
+    OCR1A = (unsigned int)(((unsigned long)ICR1 * duty_cycle) / 100UL);  // 50% duty cycle
     
     // Demonstrate different duty cycles
     for(;;){
-        // 0% duty cycle (LED completely OFF)
+        // 0% duty cycle (LED off apart from a 1-count spike each period in Fast PWM)
         OCR1A = 0;
         _delay_ms(2000);
         
         // 25% duty cycle
-        OCR1A = (ICR1 * 25) / 100;
+        OCR1A = (unsigned int)(((unsigned long)ICR1 * 25UL) / 100UL);
         _delay_ms(2000);
         
         // 50% duty cycle
-        OCR1A = (ICR1 * 50) / 100;
+        OCR1A = (unsigned int)(((unsigned long)ICR1 * 50UL) / 100UL);
         _delay_ms(2000);
         
         // 75% duty cycle
-        OCR1A = (ICR1 * 75) / 100;
+        OCR1A = (unsigned int)(((unsigned long)ICR1 * 75UL) / 100UL);
         _delay_ms(2000);
         
         // 100% duty cycle (LED completely ON)
@@ -66,7 +66,7 @@
          // This creates a quick, sharp increase in brightness
          for(step = 0; step <= pwm_steps; step++){
              duty_cycle = (step * 100) / pwm_steps;  // Calculate duty cycle percentage (0-100%)
-             OCR1A = (ICR1 * duty_cycle) / 100;      // Set PWM duty cycle
+             OCR1A = (unsigned int)(((unsigned long)ICR1 * duty_cycle) / 100UL);  // Set PWM duty cycle (32-bit multiply, 999 * 100 overflows 16 bits)
              _delay_ms(step_delay_rise);             // Wait 3ms for this step
          }
          
@@ -74,7 +74,7 @@
          // This creates a gradual, smooth decrease in brightness
          for(step = pwm_steps; step > 0; step--){
              duty_cycle = ((step - 1) * 100) / pwm_steps;  // Calculate duty cycle percentage (100-0%)
-             OCR1A = (ICR1 * duty_cycle) / 100;            // Set PWM duty cycle
+             OCR1A = (unsigned int)(((unsigned long)ICR1 * duty_cycle) / 100UL);  // Set PWM duty cycle
              _delay_ms(step_delay_fall);                   // Wait 6ms for this step
          }
          
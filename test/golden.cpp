@@ -0,0 +1,336 @@
+/* Name: golden.cpp
+ * Description: Runs one lab program (LAB_PROGRAM) in virtual time and compares
+ * the PB5 timeline against golden values
+ *
+ * Golden timing is the program's nominal timing (delay arguments x steps),
+ * not the model's output. Tolerances:
+ *   frequency, edge times     +/- 0.1%  programs whose delays are all constant
+ *   beat timing, run length   +/- 2%    ramp programs; each step also pays
+ *                                       soft-float delay setup and 32-bit math
+ *                                       the model can only estimate
+ *   keypoint time             +/- 2ms plus the timing tolerance of the offset
+ *   duty                      +/- 0.005 (levels, peaks), +/- 0.02 on ramps
+ *   CPU cycles per second     +/- 10% of the recorded baseline, at least 100
+ */
+
+#include "avr_sim.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+const double EXACT_TIMING = 0.001;
+const double LOOSE_TIMING = 0.02;
+const double DUTY_TOL = 0.005;
+const double RAMP_DUTY_TOL = 0.02;
+const double TIME_TOL = 0.002;
+const double CYCLES_TOL = 0.10;
+const double CYCLES_FLOOR = 100;
+
+int failures = 0;
+
+double secs(sim::ticks_t t) { return t / sim::CRYSTAL_HZ; }
+
+void expect(const char* what, double measured, double golden, double tol)
+{
+    bool ok = fabs(measured - golden) <= tol;
+    printf("%-4s %-36s %14.6f   golden %14.6f +/- %g\n", ok ? "ok" : "FAIL", what, measured, golden, tol);
+    if (!ok) failures++;
+}
+
+void expect_rel(const char* what, double measured, double golden, double rel)
+{
+    expect(what, measured, golden, fabs(golden) * rel);
+}
+
+// PWM duty for a 0..100 percent scaled onto ICR1 = 999, as the heartbeats do
+double percent_duty(unsigned int percent)
+{
+    unsigned int ocr = percent * 999 / 100;
+    return ocr >= 999 ? 1.0 : (ocr + 1) / 1000.0;
+}
+
+// PB5 duty at time t
+double duty_at(const sim::Result& r, double t)
+{
+    double duty = 0;
+    for (size_t i = 0; i < r.pin.size() && secs(r.pin[i].t) <= t; i++) duty = r.pin[i].duty;
+    return duty;
+}
+
+// PB5 PWM frequency at time t (0 when driven as plain GPIO)
+double pwm_hz_at(const sim::Result& r, double t)
+{
+    double hz = 0;
+    for (size_t i = 0; i < r.pin.size() && secs(r.pin[i].t) <= t; i++) hz = r.pin[i].pwm_hz;
+    return hz;
+}
+
+// Duty closest to the golden value anywhere within +/- window of t
+double duty_near(const sim::Result& r, double t, double window, double golden)
+{
+    double best = duty_at(r, t - window);
+    for (size_t i = 0; i < r.pin.size(); i++) {
+        double ts = secs(r.pin[i].t);
+        if (ts > t - window && ts <= t + window && fabs(r.pin[i].duty - golden) < fabs(best - golden))
+            best = r.pin[i].duty;
+    }
+    return best;
+}
+
+// First time in [from, to] that PB5 reaches `duty`, or -1
+double first_reach(const sim::Result& r, double duty, double from, double to)
+{
+    if (duty_at(r, from) >= duty - 1e-9) return from;
+    for (size_t i = 0; i < r.pin.size(); i++) {
+        double ts = secs(r.pin[i].t);
+        if (ts > from && ts <= to && r.pin[i].duty >= duty - 1e-9) return ts;
+    }
+    return -1;
+}
+
+// Rising GPIO edges at or after `from`
+std::vector<double> rising_edges(const sim::Result& r, double from)
+{
+    std::vector<double> edges;
+    for (size_t i = 0; i < r.pin.size(); i++) {
+        double before = i ? r.pin[i - 1].duty : 0;
+        if (r.pin[i].duty >= 0.5 && before < 0.5 && secs(r.pin[i].t) >= from) edges.push_back(secs(r.pin[i].t));
+    }
+    return edges;
+}
+
+// First rising edge at or after `from`; a missing edge is a failure, not a crash
+void expect_first_edge(const sim::Result& r, double from, double golden, double tol)
+{
+    std::vector<double> edges = rising_edges(r, from);
+    if (edges.empty())
+        expect("rising edges", 0, 1, 0);
+    else
+        expect("first rising edge (s)", edges.front(), golden, tol);
+}
+
+// Steady-state GPIO blink from the rising edges after `from`
+void expect_blink(const sim::Result& r, double from, double hz, double duty)
+{
+    std::vector<double> edges = rising_edges(r, from);
+    if (edges.size() < 2) {
+        expect("rising edges", edges.size(), 2, 0);
+        return;
+    }
+    double span = edges.back() - edges.front();
+    double high = 0;
+    for (size_t i = 0; i < r.pin.size(); i++) {
+        double t0 = secs(r.pin[i].t);
+        double t1 = i + 1 < r.pin.size() ? secs(r.pin[i + 1].t) : secs(r.end);
+        if (t0 < edges.front()) t0 = edges.front();
+        if (t1 > edges.back()) t1 = edges.back();
+        if (t1 > t0) high += (t1 - t0) * r.pin[i].duty;
+    }
+    expect_rel("blink frequency (Hz)", (edges.size() - 1) / span, hz, EXACT_TIMING);
+    expect("blink duty", high / span, duty, DUTY_TOL);
+}
+
+// Ramp keypoint `offset` seconds after an anchor time
+void expect_keypoint(const sim::Result& r, double anchor, double offset, double duty, double timing)
+{
+    char what[64];
+    snprintf(what, sizeof(what), "duty at t=%.4fs", anchor + offset);
+    expect(what, duty_near(r, anchor + offset, TIME_TOL + timing * fabs(offset), duty), duty, RAMP_DUTY_TOL);
+}
+
+void expect_level(const sim::Result& r, double t, double duty)
+{
+    char what[64];
+    snprintf(what, sizeof(what), "duty at t=%.4fs", t);
+    expect(what, duty_at(r, t), duty, DUTY_TOL);
+}
+
+// Find the next peak at `duty` one nominal `period` after `last`, check the
+// spacing, and return its measured time (or the nominal one if missing)
+double expect_next_peak(const sim::Result& r, double last, double period, double duty, double timing)
+{
+    double slack = TIME_TOL + timing * period;
+    double t = first_reach(r, duty, last + period - slack, last + period + slack);
+    if (t < 0) {
+        expect("peak found near nominal time", 0, 1, 0);
+        return last + period;
+    }
+    expect_rel("peak spacing (s)", t - last, period, timing);
+    return t;
+}
+
+// CPU cycles per second spent outside the delay loops: program basic blocks,
+// delay setup and ISR entry/exit. The golden value is a baseline recorded from
+// the model, so this catches hot-loop slowdowns, not absolute AVR cycle counts.
+void expect_work(const sim::Result& r, double cycles_per_s)
+{
+    double tol = cycles_per_s * CYCLES_TOL;
+    expect("CPU cycles per second", r.work_cycles / secs(r.end), cycles_per_s, tol > CYCLES_FLOOR ? tol : CYCLES_FLOOR);
+}
+
+void check_blink(void)
+{
+    sim::Result r = sim::run(10);
+    expect("stalled", r.stalled, 0, 0);
+    expect_first_edge(r, 0, 0, TIME_TOL);
+    expect_blink(r, 0, 0.5, 0.5);  // toggles every 1s, so a 2s period
+    expect_work(r, 4);
+}
+
+void check_variable_duty(void)
+{
+    sim::Result r = sim::run(10);
+    expect("stalled", r.stalled, 0, 0);
+    expect_first_edge(r, 0, 0, TIME_TOL);
+    expect_blink(r, 0, 1.0, 0.25);  // 250ms on, 750ms off
+    expect_work(r, 4.4);
+}
+
+void check_timer_blink(void)
+{
+    sim::Result r = sim::run(5);
+    expect("stalled", r.stalled, 0, 0);
+    // toggle on every overflow, 391 counts at 16MHz/1024 = 25.024ms
+    expect_first_edge(r, 0, 391 * 1024 / 16e6, TIME_TOL);
+    expect_blink(r, 0, 16e6 / 1024 / 391 / 2, 0.5);
+    expect_work(r, 16e6);  // the main loop busy-waits, so the CPU never idles
+}
+
+void check_clock_prescaler(void)
+{
+    sim::Result r = sim::run(40);
+    expect("stalled", r.stalled, 0, 0);
+    // one Timer1 overflow each at 16, 8 and 4MHz before the blink starts
+    double wait = 65536 * 1024 / 16e6 * (1 + 2 + 4);
+    expect_first_edge(r, 0, wait, wait * EXACT_TIMING);
+    expect_blink(r, wait, 1.0, 0.5);
+    expect_work(r, 5.03e6);  // busy-waits at 16, 8 and 4MHz, then mostly delays
+}
+
+void check_hardware_pwm(void)
+{
+    sim::Result r = sim::run(20);
+    expect("stalled", r.stalled, 0, 0);
+    expect_rel("PWM frequency (Hz)", pwm_hz_at(r, 1), 16e6 / 8 / 2000, EXACT_TIMING);
+    // 2s per level; OCR1A = 0 leaves a 1-count spike out of 2000
+    for (int cycle = 0; cycle < 2; cycle++) {
+        double t = cycle * 10.0;
+        expect_level(r, t + 1, 1 / 2000.0);
+        expect_level(r, t + 3, 500 / 2000.0);
+        expect_level(r, t + 5, 1000 / 2000.0);
+        expect_level(r, t + 7, 1500 / 2000.0);
+        expect_level(r, t + 9, 1.0);
+    }
+    expect_work(r, 0.6);
+}
+
+void check_pulsing_led(void)
+{
+    sim::Result r = sim::run(5);
+    expect("stalled", r.stalled, 0, 0);
+    const double rise = 101 * 0.003;  // steps 0..100 at 3ms
+    const double fall = 100 * 0.006;  // steps 99..0 at 6ms
+    expect_rel("PWM frequency (Hz)", pwm_hz_at(r, 0.1), 16e6 / 8 / 1000, EXACT_TIMING);
+    // the 100% step starts 3ms before the end of the rise
+    double t = first_reach(r, 1.0, 0, rise + 0.1);
+    if (t < 0) expect("first peak found", 0, 1, 0);
+    else expect("first peak (s)", t, rise - 0.003, TIME_TOL + LOOSE_TIMING * rise);
+    for (int n = 0; n < 4 && t >= 0; n++) {
+        if (n) t = expect_next_peak(r, t, rise + fall, 1.0, LOOSE_TIMING);
+        expect_keypoint(r, t, -0.300, 0.001, LOOSE_TIMING);
+        expect_keypoint(r, t, -0.150, 0.50, LOOSE_TIMING);
+        expect_keypoint(r, t, 0, 1.0, LOOSE_TIMING);
+        expect_keypoint(r, t, 0.003 + 49 * 0.006, 0.50, LOOSE_TIMING);
+        expect_keypoint(r, t, 0.003 + 99 * 0.006, 0.001, LOOSE_TIMING);
+    }
+    expect_work(r, 910);
+}
+
+// One lub-dub anchored at the lub peak. Each ramp is 51 steps: 2ms steps for
+// 100ms ramps, 8ms steps for 400ms ramps; the lub peak is step 50 of the rise.
+void expect_lub_dub(const sim::Result& r, double peak, unsigned int cap)
+{
+    expect_keypoint(r, peak, -0.050, percent_duty(50 * cap / 100), LOOSE_TIMING);
+    expect_keypoint(r, peak, 0, percent_duty(cap), LOOSE_TIMING);
+    expect_keypoint(r, peak, 0.002 + 25 * 0.008, percent_duty(50 * cap / 100), LOOSE_TIMING);
+    expect_keypoint(r, peak, 0.002 + 0.408 + 0.100, percent_duty(50 * cap / 100), LOOSE_TIMING);
+    expect_keypoint(r, peak, 0.002 + 0.408 + 0.102 + 0.400, percent_duty(0), LOOSE_TIMING);
+}
+
+void check_heartbeat(void)
+{
+    sim::Result r = sim::run(13);
+    expect("stalled", r.stalled, 0, 0);
+    // heartbeat_pattern() is lub-dub, 2s rest, lub-dub; the loop then starts the
+    // next lub-dub straight away, so lub peaks alternate 3.02s and 1.02s apart
+    const double lub_dub = 2 * 0.102 + 2 * 0.408;
+    const double gap[2] = {lub_dub + 2.0, lub_dub};
+    expect_rel("PWM frequency (Hz)", pwm_hz_at(r, 0.05), 16e6 / 8 / 1000, EXACT_TIMING);
+    double t = first_reach(r, 1.0, 0, 0.2);
+    if (t < 0) expect("first peak found", 0, 1, 0);
+    else expect("first peak (s)", t, 0.100, TIME_TOL + LOOSE_TIMING * 0.100);
+    for (int n = 0; n < 6 && t >= 0; n++) {
+        if (n) t = expect_next_peak(r, t, gap[(n - 1) % 2], 1.0, LOOSE_TIMING);
+        expect_lub_dub(r, t, 100);
+        if (n % 2 == 0) expect_level(r, t - 0.100 + lub_dub + 1.0, percent_duty(0));  // mid-rest
+    }
+    expect_work(r, 36170);
+}
+
+void check_fading_heartbeat(void)
+{
+    sim::Result r = sim::run(65);
+    expect("stalled", r.stalled, 0, 0);
+    const double beat = 2 * 0.102 + 2 * 0.408 + 2.0;  // 51-step ramps plus the 2s rest
+    // cap of beat i is (19 - i) * 100 / 19 percent, in integer math
+    const unsigned int cap[20] = {100, 94, 89, 84, 78, 73, 68, 63, 57, 52, 47, 42, 36, 31, 26, 21, 15, 10, 5, 0};
+    expect_rel("PWM frequency (Hz)", pwm_hz_at(r, 0.05), 16e6 / 8 / 1000, EXACT_TIMING);
+    double t = first_reach(r, 1.0, 0, 0.2);
+    if (t < 0) expect("first peak found", 0, 1, 0);
+    for (int i = 0; i < 19 && t >= 0; i++) {
+        if (i) t = expect_next_peak(r, t, beat, percent_duty(cap[i]), LOOSE_TIMING);
+        expect_lub_dub(r, t, cap[i]);
+    }
+    // the last beat has a 0% cap; the final OCR1A = 0 marks the end of heartbeat_weaken(20)
+    if (t >= 0) expect_level(r, t + beat + 0.100, percent_duty(0));
+    if (r.ocr1a.empty())
+        expect("OCR1A writes", 0, 1, 0);
+    else
+        expect_rel("run length (s)", secs(r.ocr1a.back().t), 20 * beat, LOOSE_TIMING);
+    expect_level(r, 64, percent_duty(0));
+    expect_work(r, 20980);
+}
+
+struct Lab {
+    const char* name;
+    void (*check)(void);
+};
+
+const Lab LABS[] = {
+    {"1.2.3 Blink", check_blink},
+    {"1.2.4 Variable_Duty-Cycle", check_variable_duty},
+    {"1.3.1 Timer_Blink", check_timer_blink},
+    {"1.3.2 Clock_Prescaler", check_clock_prescaler},
+    {"1.3.3 Hardware_PWM", check_hardware_pwm},
+    {"1.4.1 Pulsing_LED", check_pulsing_led},
+    {"1.4.2 Heartbeat", check_heartbeat},
+    {"1.4.3 Fading_Heartbeat", check_fading_heartbeat},
+};
+
+}  // namespace
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(LABS) / sizeof(LABS[0]); i++) {
+        if (strcmp(LABS[i].name, LAB_PROGRAM) != 0) continue;
+        printf("%s\n", LAB_PROGRAM);
+        LABS[i].check();
+        printf("%d failure(s)\n", failures);
+        return failures ? 1 : 0;
+    }
+    printf("no golden values for %s\n", LAB_PROGRAM);
+    return 1;
+}
@@ -0,0 +1,55 @@
+/* Name: MEAM_general.h (host stub)
+ * Description: Stand-in for MEAM_general.h that builds the lab programs on the
+ * host against the virtual-time model in avr_sim.h
+ */
+
+#ifndef MEAM_general__
+#define MEAM_general__
+
+#include "avr_sim.h"
+
+#define main lab_main  // the test harness owns the real main()
+
+// bit manipulation, same as the real header
+#define set(reg,bit)     reg |= (1<<(bit))
+#define clear(reg,bit)   reg &= ~(1<<(bit))
+#define toggle(reg,bit)  reg ^= (1<<(bit))
+#define check(reg,bit)   ((reg & (1<<(bit))) != 0)
+
+// system clock prescaler: 0 = 16MHz, 1 = 8MHz, ... 8 = 62.5kHz
+#define _clockdivide(val)  sim::clockdivide(val)
+
+#define sei()              sim::sei()
+#define cli()              sim::cli()
+
+#define ISR(vect)          extern "C" void vect(void)
+#define TIMER1_OVF_vect    lab_timer1_ovf_isr
+
+// TCCR1A
+#define COM1A1  7
+#define COM1A0  6
+#define WGM11   1
+#define WGM10   0
+
+// TCCR1B
+#define WGM13   4
+#define WGM12   3
+#define CS12    2
+#define CS11    1
+#define CS10    0
+
+// TIMSK1
+#define TOIE1   0
+
+// Like avr-libc, __builtin_constant_p is evaluated after inlining, so at -Os a
+// delay computed from constants takes the exact path and anything else the
+// float path
+static inline __attribute__((always_inline)) void _delay_ms(double __ms)
+{
+    sim::delay_ms(__ms, __builtin_constant_p(__ms));
+}
+
+extern sim::reg8 DDRB, PORTB, TCCR1A, TCCR1B, TIMSK1;
+extern sim::reg16 TCNT1, OCR1A, ICR1;
+
+#endif
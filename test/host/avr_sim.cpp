@@ -0,0 +1,281 @@
+/* Name: avr_sim.cpp
+ * Description: Virtual-time ATmega32U4 model: PB5 output, Timer1 normal and
+ * fast PWM (mode 14), system clock prescaler, _delay_ms() and Timer1 overflow ISR
+ *
+ * CPU time: the lab program is built with -fsanitize-coverage=trace-pc, so every
+ * basic block it executes calls __sanitizer_cov_trace_pc() below and is charged
+ * BLOCK_CYCLES. That is what moves virtual time through busy-wait loops and what
+ * makes extra work in a hot loop show up in the timeline and the cycle count.
+ * Blocks are counted on the host build, so the cycle figures are an estimate
+ * that scales with the program's work, not an AVR cycle count.
+ */
+
+#include "avr_sim.h"
+
+#include <math.h>
+#include <setjmp.h>
+#include <string.h>
+
+extern "C" void lab_timer1_ovf_isr(void) __attribute__((weak));
+
+sim::reg8 DDRB(sim::DDRB_), PORTB(sim::PORTB_), TCCR1A(sim::TCCR1A_), TCCR1B(sim::TCCR1B_),
+    TIMSK1(sim::TIMSK1_);
+sim::reg16 TCNT1(sim::TCNT1_), OCR1A(sim::OCR1A_), ICR1(sim::ICR1_);
+
+namespace sim {
+namespace {
+
+const unsigned int BLOCK_CYCLES = 4;          // a short AVR basic block
+const unsigned int BLOCK_QUANTUM = 64;        // cycles batched before time is advanced
+
+// Approximate AVR cycle costs charged on top of the requested delay. A
+// non-constant _delay_ms() only builds with __DELAY_BACKWARD_COMPATIBLE__,
+// which scales the argument with avr-libc's soft-float routines.
+const unsigned int DELAY_FLOAT_CYCLES = 330;  // int->float, multiply, compares, float->int
+const unsigned int DELAY_LONG_CYCLES = 180;   // extra multiply for delays over 16.38ms
+const unsigned int DELAY_LOOP_CYCLES = 5;     // per 0.1ms iteration of the long-delay loop
+const unsigned int ISR_CYCLES = 40;           // interrupt response, prologue/epilogue, reti
+
+const unsigned int RESET_CLKDIV = 3;          // CKDIV8 fuse: 2MHz until _clockdivide()
+const unsigned int PRESCALE[8] = {0, 1, 8, 64, 256, 1024, 0, 0};  // CS12:10, no external clock
+const ticks_t NEVER = ~(ticks_t)0;
+
+ticks_t now, budget, last_io;
+unsigned int clkdiv;
+bool ienable;
+unsigned int regs[REG_COUNT];
+unsigned int t1_count;
+ticks_t t1_phase;
+bool tov1;
+Result result;
+
+unsigned int pending;  // block cycles not yet turned into virtual time
+bool busy;             // inside advance(); ISR blocks just accumulate
+bool running;
+jmp_buf stop;
+
+ticks_t cpu_ticks(unsigned long long cycles) { return (ticks_t)cycles << clkdiv; }
+
+void advance(ticks_t dt);
+
+void flush(void)
+{
+    if (busy || !pending) return;
+    unsigned int cycles = pending;
+    pending = 0;
+    advance(cpu_ticks(cycles));
+}
+
+// Every call into the model is I/O: settle the program's pending work first
+void io(void)
+{
+    flush();
+    last_io = now;
+}
+
+unsigned int wgm(void)
+{
+    return (regs[TCCR1A_] & 3) | (((regs[TCCR1B_] >> 3) & 3) << 2);
+}
+
+// Crystal ticks per Timer1 count, 0 when stopped
+ticks_t timer_tick(void)
+{
+    return (ticks_t)PRESCALE[regs[TCCR1B_] & 7] << clkdiv;
+}
+
+// Overflows are only modelled in normal mode; the PWM labs never enable them
+ticks_t ticks_to_overflow(void)
+{
+    ticks_t tick = timer_tick();
+    if (!tick || wgm() != 0) return NEVER;
+    return (65536 - t1_count) * tick - t1_phase;
+}
+
+void count(ticks_t dt)
+{
+    ticks_t tick = timer_tick();
+    if (!tick || wgm() != 0) return;
+    ticks_t total = t1_phase + dt;
+    t1_count = (unsigned int)((t1_count + total / tick) % 65536);
+    t1_phase = total % tick;
+}
+
+void update_pin(void)
+{
+    double duty = 0, hz = 0;
+    if (regs[DDRB_] & (1 << 5)) {
+        ticks_t tick = timer_tick();
+        if ((regs[TCCR1A_] & (1 << 7)) && wgm() == 14 && tick) {
+            // non-inverting fast PWM: OCR1A = 0 still leaves a one-count spike
+            unsigned int top = regs[ICR1_], ocr = regs[OCR1A_];
+            hz = CRYSTAL_HZ / (double)tick / (top + 1.0);
+            duty = ocr >= top ? 1.0 : (ocr + 1.0) / (top + 1.0);
+        } else {
+            duty = (regs[PORTB_] >> 5) & 1;
+        }
+    }
+    std::vector<Sample>& pin = result.pin;
+    if (!pin.empty() && pin.back().duty == duty && pin.back().pwm_hz == hz) return;
+    if (!pin.empty() && pin.back().t == now) {
+        pin.back().duty = duty;
+        pin.back().pwm_hz = hz;
+        if (pin.size() > 1 && pin[pin.size() - 2].duty == duty && pin[pin.size() - 2].pwm_hz == hz)
+            pin.pop_back();
+        return;
+    }
+    Sample s = {now, duty, hz};
+    pin.push_back(s);
+}
+
+void finish(void)
+{
+    longjmp(stop, 1);
+}
+
+// Run the overflow ISR if it is pending and enabled; returns the ticks it took
+ticks_t dispatch(void)
+{
+    if (!tov1 || !ienable || !(regs[TIMSK1_] & (1 << 0))) return 0;
+    tov1 = false;
+    result.isr_calls++;
+    result.work_cycles += ISR_CYCLES;
+    ienable = false;
+    if (lab_timer1_ovf_isr) lab_timer1_ovf_isr();
+    ienable = true;
+    return cpu_ticks(ISR_CYCLES);
+}
+
+void advance(ticks_t dt)
+{
+    bool outer = !busy;
+    busy = true;
+    while (dt) {
+        ticks_t to_ovf = ticks_to_overflow();
+        ticks_t step = dt < to_ovf ? dt : to_ovf;
+        if (budget - now <= step) {
+            count(budget - now);
+            now = budget;
+            finish();
+        }
+        count(step);
+        now += step;
+        dt -= step;
+        if (step == to_ovf) {
+            tov1 = true;
+            dt += dispatch();
+        }
+    }
+    if (outer) busy = false;
+}
+
+}  // namespace
+
+unsigned int read(Reg r)
+{
+    flush();
+    return r == TCNT1_ ? t1_count : regs[r];
+}
+
+void write(Reg r, unsigned int value)
+{
+    io();
+    regs[r] = value;
+    if (r == TCNT1_) t1_count = value & 0xFFFF;
+    if (r == OCR1A_) {
+        Write w = {now, value};
+        result.ocr1a.push_back(w);
+    }
+    if (r == TIMSK1_) advance(dispatch());
+    update_pin();
+}
+
+void delay_ms(double ms, bool constant)
+{
+    double requested = ms * (CRYSTAL_HZ / 1e3);
+    unsigned long long cycles;
+
+    io();
+    result.delay_calls++;
+    if (constant) {
+        cycles = (unsigned long long)ceil(requested);  // __builtin_avr_delay_cycles
+    } else {
+        // __DELAY_BACKWARD_COMPATIBLE__ path of <util/delay.h>
+        double tmp = (CRYSTAL_HZ / 4e3) * ms;
+        result.runtime_delay_calls++;
+        cycles = DELAY_FLOAT_CYCLES;
+        if (tmp < 1.0) {
+            cycles += 4;
+        } else if (tmp > 65535) {
+            uint16_t ticks = (uint16_t)(ms * 10.0);
+            cycles += DELAY_LONG_CYCLES + (unsigned long long)ticks * (1600 + DELAY_LOOP_CYCLES);
+        } else {
+            cycles += 4ULL * (uint16_t)tmp;
+        }
+    }
+    result.work_cycles += (long long)cycles - llround(requested);
+    advance(cpu_ticks(cycles));
+}
+
+void clockdivide(unsigned int div)
+{
+    io();
+    clkdiv = div > 8 ? 8 : div;
+    ticks_t tick = timer_tick();
+    if (tick && t1_phase >= tick) t1_phase = tick - 1;
+    update_pin();
+}
+
+void sei(void)
+{
+    io();
+    ienable = true;
+    advance(dispatch());
+}
+
+void cli(void)
+{
+    io();
+    ienable = false;
+}
+
+Result run(double seconds)
+{
+    now = 0;
+    budget = (ticks_t)llround(seconds * CRYSTAL_HZ);
+    last_io = 0;
+    clkdiv = RESET_CLKDIV;
+    ienable = false;
+    memset(regs, 0, sizeof(regs));
+    t1_count = 0;
+    t1_phase = 0;
+    tov1 = false;
+    result = Result();
+    pending = 0;
+    busy = false;
+    update_pin();
+
+    running = true;
+    if (!setjmp(stop)) {
+        lab_main();
+        result.stalled = true;  // main() is never supposed to return
+    }
+    running = false;
+
+    busy = false;
+    result.end = now;
+    if (now - last_io > (ticks_t)(STALL_SECONDS * CRYSTAL_HZ)) result.stalled = true;
+    return result;
+}
+
+}  // namespace sim
+
+// Called by every basic block of the instrumented lab program
+extern "C" void __sanitizer_cov_trace_pc(void)
+{
+    if (!sim::running) return;
+    sim::result.blocks++;
+    sim::result.work_cycles += sim::BLOCK_CYCLES;
+    sim::pending += sim::BLOCK_CYCLES;
+    if (sim::pending >= sim::BLOCK_QUANTUM) sim::flush();
+}
@@ -0,0 +1,147 @@
+/* Name: avr_sim.h
+ * Description: Host-side model of the ATmega32U4 pieces the lab programs use
+ * (PB5, Timer1, clock prescaler, _delay_ms), run in virtual time
+ */
+
+#ifndef AVR_SIM_H
+#define AVR_SIM_H
+
+#include <stdint.h>
+#include <type_traits>
+#include <vector>
+
+int lab_main(void);  // the lab program's main(), renamed by the stub MEAM_general.h
+
+namespace sim {
+
+typedef uint64_t ticks_t;             // virtual time in 16MHz crystal ticks
+const double CRYSTAL_HZ = 16000000.0;
+
+// PB5 drive state from time t on (duty is 0 or 1 when PB5 is plain GPIO)
+struct Sample {
+    ticks_t t;
+    double duty;
+    double pwm_hz;
+};
+
+// A single register write
+struct Write {
+    ticks_t t;
+    unsigned int value;
+};
+
+struct Result {
+    std::vector<Sample> pin;           // PB5 timeline
+    std::vector<Write> ocr1a;          // every OCR1A write
+    ticks_t end;                       // virtual time when the run stopped
+    bool stalled;                      // main() returned, or no I/O for the last STALL_SECONDS
+    unsigned long delay_calls;
+    unsigned long runtime_delay_calls; // _delay_ms() with a non-constant argument
+    unsigned long isr_calls;
+    unsigned long long blocks;         // basic blocks executed by the lab program
+    long long work_cycles;             // CPU cycles outside the delay loops (see avr_sim.cpp)
+};
+
+const double STALL_SECONDS = 3.0;  // longer than any single delay in the labs
+
+// Run lab_main() until the virtual-time budget is used up
+Result run(double seconds);
+
+enum Reg { DDRB_, PORTB_, TCCR1A_, TCCR1B_, TIMSK1_, TCNT1_, OCR1A_, ICR1_, REG_COUNT };
+
+unsigned int read(Reg r);
+void write(Reg r, unsigned int value);
+void delay_ms(double ms, bool constant);
+void clockdivide(unsigned int div);
+void sei(void);
+void cli(void);
+
+// 8-bit I/O register
+class reg8 {
+public:
+    explicit reg8(Reg id) : id_(id) {}
+    operator unsigned int() const { return read(id_); }
+    reg8& operator=(const reg8& o) { write(id_, o); return *this; }
+    template <class T> reg8& operator=(T v) { write(id_, (unsigned int)v & 0xFF); return *this; }
+    template <class T> reg8& operator|=(T v) { return *this = read(id_) | ((unsigned int)v & 0xFF); }
+    template <class T> reg8& operator&=(T v) { return *this = read(id_) & ((unsigned int)v & 0xFF); }
+    template <class T> reg8& operator^=(T v) { return *this = read(id_) ^ ((unsigned int)v & 0xFF); }
+private:
+    Reg id_;
+};
+
+// 16-bit timer register
+class reg16 {
+public:
+    explicit reg16(Reg id) : id_(id) {}
+    operator unsigned int() const { return read(id_); }
+    reg16& operator=(const reg16& o) { write(id_, o); return *this; }
+    template <class T> reg16& operator=(T v) { write(id_, (unsigned int)v & 0xFFFF); return *this; }
+private:
+    Reg id_;
+};
+
+// AVR's unsigned int is 16 bits, so arithmetic on a 16-bit register with an
+// int-sized operand wraps at 65536 on the target; avr_uint keeps that on the host.
+// Only expressions with a register operand are covered: plain int variables in
+// the lab code stay 32 bits, so their overflows go unnoticed.
+struct avr_uint {
+    uint16_t v;
+    explicit avr_uint(unsigned int x) : v((uint16_t)x) {}
+    operator unsigned int() const { return v; }
+};
+
+inline unsigned int value(const avr_uint& a) { return a.v; }
+inline unsigned int value(const reg16& r) { return r; }
+
+template <class T> struct is_avr16 : std::false_type {};
+template <> struct is_avr16<avr_uint> : std::true_type {};
+template <> struct is_avr16<reg16> : std::true_type {};
+
+// int-sized operands stay 16-bit, long operands widen the whole expression
+template <class T, bool Wide = (sizeof(T) > sizeof(int))>
+struct avr_arith {
+    typedef avr_uint type;
+    static unsigned int operand(unsigned long long x) { return (uint16_t)x; }
+};
+template <class T>
+struct avr_arith<T, true> {
+    typedef T type;
+    static T operand(T x) { return x; }
+};
+
+#define SIM_AVR16_OP(op)                                                              \
+    template <class A, class T>                                                       \
+    typename std::enable_if<is_avr16<A>::value && std::is_integral<T>::value,         \
+                            typename avr_arith<T>::type>::type                        \
+    operator op(const A& a, T b)                                                      \
+    {                                                                                 \
+        return typename avr_arith<T>::type(avr_arith<T>::operand(value(a)) op         \
+                                           avr_arith<T>::operand(b));                 \
+    }                                                                                 \
+    template <class T, class A>                                                       \
+    typename std::enable_if<is_avr16<A>::value && std::is_integral<T>::value,         \
+                            typename avr_arith<T>::type>::type                        \
+    operator op(T a, const A& b)                                                      \
+    {                                                                                 \
+        return typename avr_arith<T>::type(avr_arith<T>::operand(a) op                \
+                                           avr_arith<T>::operand(value(b)));          \
+    }                                                                                 \
+    template <class A, class B>                                                       \
+    typename std::enable_if<is_avr16<A>::value && is_avr16<B>::value, avr_uint>::type \
+    operator op(const A& a, const B& b)                                               \
+    {                                                                                 \
+        return avr_uint(value(a) op value(b));                                        \
+    }
+
+SIM_AVR16_OP(+)
+SIM_AVR16_OP(-)
+SIM_AVR16_OP(*)
+SIM_AVR16_OP(/)
+SIM_AVR16_OP(%)
+
+#undef SIM_AVR16_OP
+
+}  // namespace sim
+
+#endif